@@ -37,12 +37,24 @@
 
 #define LINEWIDTH 0.001
 
+/*
+ * The most segments one procedural can hold, so that counting their
+ * points and coordinates never overflows an int
+ */
+#define MAX_SEGMENTS (INT_MAX / 8)
+
 #include <math.h>
 #include <ri.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <limits.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define HAVE_SSE
+#endif
 
 #ifdef _WIN32
 #define export __declspec(dllexport)
@@ -71,78 +83,263 @@ struct pointData {
     RtPoint* testpoints; // For optional lines
 };
 
+/*
+ * Reads a number, setting next just past it, or to p if there isn't
+ * one. Plain decimals of up to 15 digits with a small exponent, which
+ * is all l2rib writes, are read directly; the digits and the power of
+ * ten are both exact doubles, so the result is the same as strtod's.
+ * Anything else is left to strtod.
+ */
+static double readFloat(char* p, char** next)
+{
+    static const double powers[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    char* s = p;
+    double value = 0;
+    int negative = 0, digits = 0, exponent = 0, e = 0, enegative = 0;
+
+    while (*s == ' ') ++s;
+    if (*s == '-' || *s == '+') {
+	negative = (*s++ == '-');
+    }
+    for (; *s >= '0' && *s <= '9'; ++s, ++digits) {
+	value = value * 10 + (*s - '0');
+    }
+    if (*s == '.') {
+	for (++s; *s >= '0' && *s <= '9'; ++s, ++digits, --exponent) {
+	    value = value * 10 + (*s - '0');
+	}
+    }
+    if (digits == 0 || digits > 15) {
+	return strtod(p, next);
+    }
+    if (*s == 'e' || *s == 'E') {
+	++s;
+	if (*s == '-' || *s == '+') {
+	    enegative = (*s++ == '-');
+	}
+	if (*s < '0' || *s > '9') {
+	    return strtod(p, next);
+	}
+	for (; *s >= '0' && *s <= '9' && e < 100; ++s) {
+	    e = e * 10 + (*s - '0');
+	}
+	exponent += enegative ? -e : e;
+    }
+    if ((*s != 0 && *s != ' ') || exponent < -22 || exponent > 22) {
+	return strtod(p, next);
+    }
+    *next = s;
+    value = (exponent < 0) ? value / powers[-exponent] : value * powers[exponent];
+    return negative ? -value : value;
+}
+
+/*
+ * Reads n points from the parameter string, returning where it left
+ * off. Anything missing is left as zero.
+ */
+static char* readPoints(char* p, RtPoint* points, int n)
+{
+    int i, j;
+    char* next;
+
+    for (i = 0; i < n; ++i) {
+	for (j = 0; j < 3; ++j) {
+	    points[i][j] = (RtFloat) readFloat(p, &next);
+	    if (next == p) {
+		return p;
+	    }
+	    p = next;
+	}
+    }
+    return p;
+}
+
 export RtPointer ConvertParameters(RtString param)
 {
-    char* myparam = strdup(param);
     struct pointData* points;
-    char* token;
+    char* p = param;
+    long length;
     int i, type;
 
     points = (struct pointData *) calloc (1, sizeof(struct pointData));
-    token = strtok(myparam, " ");
-    points->length = atoi(token);
-    token = strtok(NULL, " ");    
-    type = atoi(token);
+    length = strtol(p, &p, 10);
+    type = (int) strtol(p, &p, 10);
+    /*
+     * A count is never trusted beyond what it could be: every segment
+     * takes more than one character of what's left
+     */
+    if (length < 0) {
+	length = 0;
+    } else if (length > MAX_SEGMENTS) {
+	length = MAX_SEGMENTS;
+    }
+    if ((size_t) length > strlen(p)) {
+	length = (long) strlen(p);
+    }
+    points->length = (int) length;
     if (type == 1) {
 	points->type = LINEAR;
-	points->points = (RtPoint*) malloc(points->length * 2 * sizeof(RtPoint));
-	for (i = 0; i < points->length * 2; ++i) {
-	    token = strtok(NULL, " ");
-	    points->points[i][0] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i][1] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i][2] = atof(token);
+	points->points = (RtPoint*) calloc(points->length * 2 + 1, sizeof(RtPoint));
+	if (points->points) {
+	    readPoints(p, points->points, points->length * 2);
 	}
     } else if (type == 2) {
+	/* Each segment is followed by its two test points */
 	points->type = LINEAR_OPTIONAL;
-	points->points = (RtPoint*) malloc(points->length * 2 * sizeof(RtPoint));
-	points->testpoints = (RtPoint*) malloc(points->length * 2 * sizeof(RtPoint));	
-	for (i = 0; i < points->length * 2; i+=2) {
-	    token = strtok(NULL, " ");
-	    points->points[i][0] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i][1] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i][2] = atof(token);
-
-	    token = strtok(NULL, " ");
-	    points->points[i+1][0] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i+1][1] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i+1][2] = atof(token);
-
-	    token = strtok(NULL, " ");
-	    points->testpoints[i][0] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->testpoints[i][1] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->testpoints[i][2] = atof(token);
-
-	    token = strtok(NULL, " ");
-	    points->testpoints[i+1][0] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->testpoints[i+1][1] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->testpoints[i+1][2] = atof(token);
+	points->points = (RtPoint*) calloc(points->length * 2 + 1, sizeof(RtPoint));
+	points->testpoints = (RtPoint*) calloc(points->length * 2 + 1, sizeof(RtPoint));
+	if (points->points && points->testpoints) {
+	    for (i = 0; i < points->length * 2; i += 2) {
+		p = readPoints(p, points->points + i, 2);
+		p = readPoints(p, points->testpoints + i, 2);
+	    }
 	}
     } else if (type == 3) {
 	points->type = CUBIC;
-	points->points = (RtPoint*) malloc(points->length * 4 * sizeof(RtPoint));
-	for (i = 0; i < points->length * 4; ++i) {
-	    token = strtok(NULL, " ");
-	    points->points[i][0] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i][1] = atof(token);
-	    token = strtok(NULL, " ");
-	    points->points[i][2] = atof(token);
+	points->points = (RtPoint*) calloc(points->length * 4 + 1, sizeof(RtPoint));
+	if (points->points) {
+	    readPoints(p, points->points, points->length * 4);
 	}
+    } else {
+	points->length = 0;
+    }
+    /* A count too big to allocate for draws nothing */
+    if (!points->points || (points->type == LINEAR_OPTIONAL && !points->testpoints)) {
+	points->length = 0;
     }
-    free(myparam);
     return (RtPointer) points;
 }
 
+/*
+ * Sets keep for each segment from (x0, y0) to (x1, y1) whose test
+ * points (tx0, ty0) and (tx1, ty1) are on the same side of it. We
+ * solve for the coefficients of the equation ax + by + c = 0 using
+ * the segment, then put the two test points into that equation and
+ * compare the signs. Four segments are tested at a time where SSE is
+ * available.
+ */
+static void sideTest(const float* x0, const float* y0, const float* x1, const float* y1,
+		     const float* tx0, const float* ty0, const float* tx1, const float* ty1,
+		     int n, char* keep)
+{
+    int i = 0;
+    float a, b, c, sign1, sign2;
+
+#ifdef HAVE_SSE
+    __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+	__m128 vx0 = _mm_loadu_ps(x0 + i);
+	__m128 vy0 = _mm_loadu_ps(y0 + i);
+	__m128 vx1 = _mm_loadu_ps(x1 + i);
+	__m128 vy1 = _mm_loadu_ps(y1 + i);
+	__m128 va = _mm_sub_ps(vy0, vy1);
+	__m128 vb = _mm_sub_ps(vx1, vx0);
+	__m128 vc = _mm_sub_ps(_mm_mul_ps(vx0, vy1), _mm_mul_ps(vx1, vy0));
+	__m128 vsign1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(tx0 + i)),
+					      _mm_mul_ps(vb, _mm_loadu_ps(ty0 + i))), vc);
+	__m128 vsign2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(tx1 + i)),
+					      _mm_mul_ps(vb, _mm_loadu_ps(ty1 + i))), vc);
+	/* A bit is set where the signs differ */
+	int differ = _mm_movemask_ps(_mm_xor_ps(_mm_cmpgt_ps(vsign1, zero), _mm_cmpgt_ps(vsign2, zero)));
+	keep[i] = (differ & 1) == 0;
+	keep[i + 1] = (differ & 2) == 0;
+	keep[i + 2] = (differ & 4) == 0;
+	keep[i + 3] = (differ & 8) == 0;
+    }
+#endif
+    for (; i < n; ++i) {
+	a = y0[i] - y1[i];
+	b = x1[i] - x0[i];
+	c = x0[i] * y1[i] - x1[i] * y0[i];
+	sign1 = a * tx0[i] + b * ty0[i] + c;
+	sign2 = a * tx1[i] + b * ty1[i] + c;
+	keep[i] = (sign1 > 0) == (sign2 > 0);
+    }
+}
+
+/*
+ * Removes the optional segments which shouldn't be drawn from
+ * points, whose segments are already in world space, and returns how
+ * many are left.
+ */
+static int cullOptional(struct pointData* points)
+{
+    int n = points->length;
+    RtPoint* raster = (RtPoint*) malloc(4 * n * sizeof(RtPoint));
+    float* soa = (float*) malloc(8 * n * sizeof(float));
+    char* keep = (char*) malloc(n);
+    int i, kept;
+
+    /* Transform the segments and their test points to raster space */
+    memcpy(raster, points->points, 2 * n * sizeof(RtPoint));
+    memcpy(raster + 2 * n, points->testpoints, 2 * n * sizeof(RtPoint));
+    RiTransformPoints("world", "raster", 2 * n, raster);
+    RiTransformPoints("object", "raster", 2 * n, raster + 2 * n);
+
+    /* Split out the coordinates the side test needs into arrays */
+    for (i = 0; i < n; ++i) {
+	soa[i] = raster[2 * i][0];
+	soa[n + i] = raster[2 * i][1];
+	soa[2 * n + i] = raster[2 * i + 1][0];
+	soa[3 * n + i] = raster[2 * i + 1][1];
+	soa[4 * n + i] = raster[2 * n + 2 * i][0];
+	soa[5 * n + i] = raster[2 * n + 2 * i][1];
+	soa[6 * n + i] = raster[2 * n + 2 * i + 1][0];
+	soa[7 * n + i] = raster[2 * n + 2 * i + 1][1];
+    }
+    sideTest(soa, soa + n, soa + 2 * n, soa + 3 * n,
+	     soa + 4 * n, soa + 5 * n, soa + 6 * n, soa + 7 * n, n, keep);
+
+    kept = 0;
+    for (i = 0; i < n; ++i) {
+	if (keep[i]) {
+	    if (kept != i) {
+		memcpy(points->points[2 * kept], points->points[2 * i], 2 * sizeof(RtPoint));
+	    }
+	    ++kept;
+	}
+    }
+    free(raster);
+    free(soa);
+    free(keep);
+    return kept;
+}
+
+/*
+ * Computing line widths for each end of each curve. Make a line
+ * cover LINEWIDTH units of NDC space.  Project a disc in NDC to world
+ * space and see how much width space units we need. The ends of all
+ * the curves are transformed together.
+ */
+static void computeWidths(RtPoint* P, int ncurves, int nverts, RtFloat* width)
+{
+    int n = 2 * ncurves;
+    RtPoint* widthtest = (RtPoint*) malloc(2 * n * sizeof(RtPoint));
+    float xdiff, ydiff, zdiff;
+    int i;
+
+    for (i = 0; i < ncurves; ++i) {
+	memcpy(widthtest[2 * i], P[i * nverts], sizeof(RtPoint));
+	memcpy(widthtest[2 * i + 1], P[i * nverts + nverts - 1], sizeof(RtPoint));
+    }
+    RiTransformPoints("world", "NDC", n, widthtest);
+    for (i = 0; i < n; ++i) {
+	widthtest[n + i][0] = widthtest[i][0] + LINEWIDTH;
+	widthtest[n + i][1] = widthtest[i][1] + LINEWIDTH;
+	widthtest[n + i][2] = widthtest[i][2];
+    }
+    RiTransformPoints("NDC", "world", 2 * n, widthtest);
+    for (i = 0; i < n; ++i) {
+	xdiff = widthtest[n + i][0] - widthtest[i][0];
+	ydiff = widthtest[n + i][1] - widthtest[i][1];
+	zdiff = widthtest[n + i][2] - widthtest[i][2];
+	width[i] = sqrt(xdiff * xdiff + ydiff * ydiff + zdiff * zdiff);
+    }
+    free(widthtest);
+}
 
 export RtVoid Subdivide(RtPointer data, RtFloat detail)
 {
@@ -150,112 +347,42 @@ export RtVoid Subdivide(RtPointer data, RtFloat detail)
     RtInt* nvertices;
     RtFloat* width;
     RtToken type;
-    int i, start, end;
+    int i, ncurves, nverts;
 
-    nvertices = (RtInt*) malloc(points->length * sizeof(RtInt));
-    /* Two widths per curve, since each curve is one segment */
-    width = (RtFloat*) malloc(2 * (points->length) * sizeof(RtFloat));
-    if (points->type == LINEAR || points->type == LINEAR_OPTIONAL) {
-	type = RI_LINEAR;
-	for (i = 0; i < points->length; ++i) {
-	    nvertices[i] = 2;
-	}
-	RiTransformPoints("object", "world", points->length * 2, points->points);
-    } else if (points->type == CUBIC) {
-	type = RI_CUBIC;
-	for (i = 0; i < points->length; ++i) {
-	    nvertices[i] = 4;
-	}
-	RiTransformPoints("object", "world", points->length * 4, points->points);
-	RiBasis(RiBezierBasis, RI_BEZIERSTEP, RiBezierBasis, RI_BEZIERSTEP);
+    if (points->length == 0) {
+	return;
     }
-
-    /*
-     * Computing line widths for each segment. Make a line cover
-     * LINEWIDTH units of NDC space.  Project a disc in NDC to world
-     * space and see how much width space units we need.
-     */
-    start = 0;
-    if (points->type == LINEAR || points->type == LINEAR_OPTIONAL) {
-	end = 1;
+    if (points->type == CUBIC) {
+	type = RI_CUBIC;
+	nverts = 4;
     } else {
-	end = 3;
+	type = RI_LINEAR;
+	nverts = 2;
     }
-    for (i = 0; i < points->length; ++i) {
-	/* Line segment beginning width */
-	RtPoint widthtest[2];
-	float xdiff, ydiff, zdiff;
-	
-	memcpy(widthtest[0], points->points[start], sizeof(RtPoint));
-	RiTransformPoints("world", "NDC", 1, widthtest);
-	widthtest[1][0] = widthtest[0][0] + LINEWIDTH;
-	widthtest[1][1] = widthtest[0][1] + LINEWIDTH;
-	widthtest[1][2] = widthtest[0][2];
-	RiTransformPoints("NDC", "world", 2, widthtest);
-	xdiff = widthtest[1][0] - widthtest[0][0];
-	ydiff = widthtest[1][1] - widthtest[0][1];
-	zdiff = widthtest[1][2] - widthtest[0][2];
-	width[2*i] = sqrt(xdiff * xdiff + ydiff * ydiff + zdiff * zdiff);
+    RiTransformPoints("object", "world", points->length * nverts, points->points);
 
-	/* Line segment end width */
-	memcpy(widthtest[0], points->points[end], sizeof(RtPoint));	
-	RiTransformPoints("world", "NDC", 1, widthtest);
-	widthtest[1][0] = widthtest[0][0] + LINEWIDTH;
-	widthtest[1][1] = widthtest[0][1] + LINEWIDTH;
-	widthtest[1][2] = widthtest[0][2];
-	RiTransformPoints("NDC", "world", 2, widthtest);
-	xdiff = widthtest[1][0] - widthtest[0][0];
-	ydiff = widthtest[1][1] - widthtest[0][1];
-	zdiff = widthtest[1][2] - widthtest[0][2];	
-	width[2*i+1] = sqrt(xdiff * xdiff + ydiff * ydiff + zdiff * zdiff);
-
-	if (points->type == LINEAR || points->type == LINEAR_OPTIONAL) {
-	    start += 2; end += 2;
-	} else {
-	    start += 4; end += 4;
+    ncurves = points->length;
+    if (points->type == LINEAR_OPTIONAL) {
+	ncurves = cullOptional(points);
+	if (ncurves == 0) {
+	    return;
 	}
     }
 
-    RiIdentity();
-
-    if (points->type == LINEAR || points->type == CUBIC) {
-	RiCurves(type, points->length, nvertices, "nonperiodic", "P", points->points, "width", width, RI_NULL);
-    } else {
-	/* Handling of optional; each will be a separate curve call */
-	for (i = 0; i < points->length; i += 2) {
-	    float a, b, c, sign1, sign2;
-	    
-	    RtPoint rastertest[4];
-
-	    /* Transform all four points to raster space */
-	    memcpy(rastertest[0], points->points[i], 2 * sizeof(RtPoint));
-	    memcpy(rastertest[2], points->testpoints[i], 2 * sizeof(RtPoint));
-	    RiTransformPoints("world", "raster", 4, rastertest);
-
-	    /*
-	     * Test to see which side of the line the two test points
-	     * are.  We solve for the coefficient of the equation ax +
-	     * by + c = 0 using the first two points, then put the two
-	     * test points into that equation and compare the signs.
-	     */
-	    a = rastertest[0][1] - rastertest[1][1];
-	    b = rastertest[1][0] - rastertest[0][0];
-	    c = (rastertest[0][0] * rastertest[1][1] -
-		 rastertest[1][0] * rastertest[0][1]);
-	    
-	    sign1 = a * rastertest[0][0] + b * rastertest[0][1] + c;
-	    sign2 = a * rastertest[1][0] + b * rastertest[1][1] + c;
-	    
-	    sign1 = a * rastertest[2][0] + b * rastertest[2][1] + c;
-	    sign2 = a * rastertest[3][0] + b * rastertest[3][1] + c;
-
-	    if ((sign1 > 0) == (sign2 > 0)) {
-		/* If test passed, emit the curve */
-		RiCurves(type, 1, nvertices + i, "nonperiodic", "P", points->points + 2 * i, "width", width + i, RI_NULL);
-	    }
-	}
+    nvertices = (RtInt*) malloc(ncurves * sizeof(RtInt));
+    for (i = 0; i < ncurves; ++i) {
+	nvertices[i] = nverts;
+    }
+    /* Two widths per curve, since each curve is one segment */
+    width = (RtFloat*) malloc(2 * ncurves * sizeof(RtFloat));
+    computeWidths(points->points, ncurves, nverts, width);
 
+    if (points->type == CUBIC) {
+	RiBasis(RiBezierBasis, RI_BEZIERSTEP, RiBezierBasis, RI_BEZIERSTEP);
     }
+    RiIdentity();
+    RiCurves(type, ncurves, nvertices, "nonperiodic", "P", points->points, "width", width, RI_NULL);
+
     free(nvertices);
     free(width);
 }
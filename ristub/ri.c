@@ -0,0 +1,244 @@
+/*
+ * ri.c - http://www.levork.org/l2rib.html
+ *
+ * Copyright  2001-2004 by Julian Fong (http://www.levork.org/).  All
+ * rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * The RenderMan (R) Interface Procedures and RIB Protocol are:
+ * Copyright 1988, 1989, Pixar. All rights reserved.
+ * RenderMan (R) is a registered trademark of Pixar.
+ *
+ * A recording RenderMan backend for running line.c on its own. The
+ * calls the procedural makes are written to stdout as RIB, with a
+ * count of the points it transformed, so that runs can be compared
+ * with each other. The camera is a fixed 90 degree perspective one,
+ * CAMERADISTANCE units down the z axis from the world origin, with
+ * object space the same as world space.
+ *
+ * Usage: line.stub [-n count] [file]
+ *
+ * The file, or stdin, holds the string l2rib passes to line.rll. With
+ * -n, the procedural is run count times and the time taken is written
+ * to stderr; only the first run is recorded.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ri.h"
+
+#define CAMERADISTANCE 10.0f
+#define XRESOLUTION 640
+#define YRESOLUTION 480
+
+RtPointer ConvertParameters(RtString paramstr);
+RtVoid Subdivide(RtPointer data, RtFloat detail);
+RtVoid Free(RtPointer data);
+
+RtToken RI_LINEAR = "linear";
+RtToken RI_CUBIC = "cubic";
+RtBasis RiBezierBasis = {
+    { -1,  3, -3, 1 },
+    {  3, -6,  3, 0 },
+    { -3,  3,  0, 0 },
+    {  1,  0,  0, 0 }
+};
+
+static int recording = 1;
+static long transformCalls = 0;
+static long transformPoints = 0;
+
+/* Moves a point from the given space into world space */
+static int toWorld(const char* space, RtFloat* p)
+{
+    if (!strcmp(space, "raster")) {
+	p[0] /= XRESOLUTION;
+	p[1] /= YRESOLUTION;
+	space = "NDC";
+    }
+    if (!strcmp(space, "NDC")) {
+	p[0] = (2 * p[0] - 1) * p[2];
+	p[1] = (1 - 2 * p[1]) * p[2];
+	space = "camera";
+    }
+    if (!strcmp(space, "camera")) {
+	p[2] -= CAMERADISTANCE;
+	space = "world";
+    }
+    return !strcmp(space, "world") || !strcmp(space, "object");
+}
+
+/* Moves a point from world space into the given space */
+static int fromWorld(const char* space, RtFloat* p)
+{
+    if (!strcmp(space, "world") || !strcmp(space, "object")) {
+	return 1;
+    }
+    p[2] += CAMERADISTANCE;
+    if (!strcmp(space, "camera")) {
+	return 1;
+    }
+    /* NDC keeps the camera space depth, so that it can be undone */
+    p[0] = (p[0] / p[2] + 1) / 2;
+    p[1] = (1 - p[1] / p[2]) / 2;
+    if (!strcmp(space, "NDC")) {
+	return 1;
+    }
+    p[0] *= XRESOLUTION;
+    p[1] *= YRESOLUTION;
+    return !strcmp(space, "raster");
+}
+
+RtPoint* RiTransformPoints(RtToken fromspace, RtToken tospace, RtInt n, RtPoint points[])
+{
+    RtInt i;
+
+    transformCalls++;
+    transformPoints += n;
+    for (i = 0; i < n; ++i) {
+	if (!toWorld(fromspace, points[i]) || !fromWorld(tospace, points[i])) {
+	    fprintf(stderr, "Unknown space in RiTransformPoints: %s to %s\n", fromspace, tospace);
+	    return 0;
+	}
+    }
+    return points;
+}
+
+RtVoid RiIdentity(void)
+{
+    if (recording) {
+	printf("Identity\n");
+    }
+}
+
+static void printFloats(const RtFloat* f, int n)
+{
+    int i;
+    printf("[");
+    for (i = 0; i < n; ++i) {
+	printf(i ? " %g" : "%g", f[i]);
+    }
+    printf("]");
+}
+
+RtVoid RiBasis(RtBasis ubasis, RtInt ustep, RtBasis vbasis, RtInt vstep)
+{
+    if (recording) {
+	printf("Basis ");
+	printFloats(&ubasis[0][0], 16);
+	printf(" %d ", ustep);
+	printFloats(&vbasis[0][0], 16);
+	printf(" %d\n", vstep);
+    }
+}
+
+RtVoid RiCurves(RtToken type, RtInt ncurves, RtInt nvertices[], RtToken wrap, ...)
+{
+    va_list args;
+    RtToken token;
+    RtInt i, nverts = 0;
+
+    if (!recording) {
+	return;
+    }
+    for (i = 0; i < ncurves; ++i) {
+	nverts += nvertices[i];
+    }
+    printf("Curves \"%s\" [", type);
+    for (i = 0; i < ncurves; ++i) {
+	printf(i ? " %d" : "%d", nvertices[i]);
+    }
+    printf("] \"%s\"", wrap);
+    va_start(args, wrap);
+    while ((token = va_arg(args, RtToken)) != RI_NULL) {
+	RtFloat* values = va_arg(args, RtFloat*);
+	printf(" \"%s\" ", token);
+	if (!strcmp(token, "P")) {
+	    printFloats(values, 3 * nverts);
+	} else {
+	    /* Everything else is varying, which is two per curve */
+	    printFloats(values, 2 * ncurves);
+	}
+    }
+    va_end(args);
+    printf("\n");
+}
+
+/* Reads all of a file into a string */
+static char* readAll(FILE* in)
+{
+    size_t size = 0, capacity = 65536, n;
+    char* text = (char*) malloc(capacity + 1);
+
+    while ((n = fread(text + size, 1, capacity - size, in)) > 0) {
+	size += n;
+	if (size == capacity) {
+	    capacity *= 2;
+	    text = (char*) realloc(text, capacity + 1);
+	}
+    }
+    text[size] = 0;
+    return text;
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* in = stdin;
+    char* param;
+    int count = 1, i = 1;
+    clock_t start;
+
+    if (i + 1 < argc && !strcmp(argv[i], "-n")) {
+	count = atoi(argv[i + 1]);
+	i += 2;
+    }
+    if (i < argc) {
+	in = fopen(argv[i], "r");
+	if (!in) {
+	    fprintf(stderr, "Unable to open file: %s\n", argv[i]);
+	    return 1;
+	}
+    }
+    param = readAll(in);
+    if (in != stdin) {
+	fclose(in);
+    }
+
+    start = clock();
+    for (i = 0; i < count; ++i) {
+	RtPointer data = ConvertParameters(param);
+	Subdivide(data, 0);
+	Free(data);
+	if (i == 0) {
+	    printf("# %ld RiTransformPoints calls, %ld points\n", transformCalls, transformPoints);
+	    recording = 0;
+	}
+    }
+    if (count > 1) {
+	fprintf(stderr, "%d runs in %.3f seconds\n", count, (double) (clock() - start) / CLOCKS_PER_SEC);
+    }
+    free(param);
+    return 0;
+}
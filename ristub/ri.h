@@ -0,0 +1,67 @@
+/*
+ * ri.h - http://www.levork.org/l2rib.html
+ *
+ * Copyright  2001-2004 by Julian Fong (http://www.levork.org/).  All
+ * rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * The RenderMan (R) Interface Procedures and RIB Protocol are:
+ * Copyright 1988, 1989, Pixar. All rights reserved.
+ * RenderMan (R) is a registered trademark of Pixar.
+ *
+ * A stand in for the parts of the RenderMan interface which line.c
+ * uses, so that the procedural can be built, run and timed without a
+ * RenderMan install. See ri.c.
+ */
+
+#ifndef RI_H
+#define RI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void RtVoid;
+typedef void* RtPointer;
+typedef char* RtToken;
+typedef char* RtString;
+typedef float RtFloat;
+typedef int RtInt;
+typedef RtFloat RtPoint[3];
+typedef RtFloat RtBasis[4][4];
+
+#define RI_NULL ((RtToken) 0)
+#define RI_BEZIERSTEP ((RtInt) 3)
+
+extern RtToken RI_LINEAR, RI_CUBIC;
+extern RtBasis RiBezierBasis;
+
+RtPoint* RiTransformPoints(RtToken fromspace, RtToken tospace, RtInt n, RtPoint points[]);
+RtVoid RiIdentity(void);
+RtVoid RiBasis(RtBasis ubasis, RtInt ustep, RtBasis vbasis, RtInt vstep);
+RtVoid RiCurves(RtToken type, RtInt ncurves, RtInt nvertices[], RtToken wrap, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+#!/bin/sh
+#
+# Runs the line procedural, built against the recording backend in
+# ristub/, on each parameter string in tests/line and compares what
+# it calls with the expected RIB next to it. Run from the top
+# directory as tests/line.sh ./line.stub
+
+STUB=$1
+TESTS=`dirname $0`/line
+OUT=`mktemp /tmp/l2rib.XXXXXX` || exit 1
+trap 'rm -f $OUT' 0
+
+status=0
+for input in $TESTS/*.txt; do
+    expected=`echo $input | sed 's/\.txt$/.rib/'`
+    if ! $STUB $input > $OUT || ! cmp -s $OUT $expected; then
+	echo "line.sh: `basename $input` differs from `basename $expected`"
+	diff $expected $OUT | head -10
+	status=1
+    fi
+done
+[ $status = 0 ] && echo "line.sh: ok"
+exit $status
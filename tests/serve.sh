@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Checks that a conversion made through -serve doesn't leave cache
+# RIBs behind which a later conversion with other options would take
+# as valid. Run from the top directory as tests/serve.sh ./l2rib
+
+L2RIB=`cd \`dirname $1\` && pwd`/`basename $1`
+TESTS=`cd \`dirname $0\` && pwd`
+WORK=`mktemp -d /tmp/l2rib.XXXXXX` || exit 1
+trap 'kill $SERVER 2>/dev/null; rm -rf $WORK' 0
+
+HOME=$WORK
+export HOME
+cat > $WORK/.l2ribrc <<EOF
+ldrawdir=$TESTS/ldraw
+l2ribdir=$TESTS/..
+cachedir=$WORK/cache
+EOF
+mkdir $WORK/cache
+cd $WORK
+
+$L2RIB -serve $WORK/sock 2> $WORK/serve.err &
+SERVER=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S $WORK/sock ] && break
+    sleep 1
+done
+
+fail() {
+    echo "serve.sh: $1"
+    exit 1
+}
+
+# Inlined, 3003.rib holds box5's polygons itself
+$L2RIB -connect $WORK/sock -inline 20 -o inline.rib $TESTS/serve.ldr || fail "inline conversion failed"
+$L2RIB -decode cache/3003.rib | grep -q box5 && fail "box5 wasn't inlined"
+
+# Without inlining it has to be rebuilt to refer to box5.rib, both
+# through the server and without it
+$L2RIB -connect $WORK/sock -o plain.rib $TESTS/serve.ldr || fail "plain conversion failed"
+$L2RIB -decode cache/3003.rib | grep -q box5 || fail "inlined 3003.rib reused by the server"
+
+$L2RIB -connect $WORK/sock -inline 20 -o inline.rib $TESTS/serve.ldr || fail "inline conversion failed"
+$L2RIB -o plain.rib $TESTS/serve.ldr || fail "plain conversion failed"
+$L2RIB -decode cache/3003.rib | grep -q box5 || fail "inlined 3003.rib reused"
+
+echo "serve.sh: ok"